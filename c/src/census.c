@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <err.h>
+#include <signal.h>
+#include <errno.h>
+#include <syscall.h>
+#include <unistd.h>
+#include "census.h"
+#include "common.h"
+#include "subreap_lib.h"
+#include "supervise_protocol.h"
+
+void write_census_event(const int statusfd, const int type, const pid_t pid, const pid_t ppid, const int status) {
+    struct supervise_event event = {
+	.zero = 0, .type = type, .pid = pid, .ppid = ppid, .status = status,
+    };
+    write_status(statusfd, &event, sizeof(event));
+}
+
+/* Calls visit on each pid in a children stream, then closes it. */
+void visit_children_stream(FILE *children, struct census *census, const pid_t parent,
+			   void (*visit)(struct census *census, pid_t pid, pid_t parent, int statusfd),
+			   const int statusfd) {
+    for (;;) {
+	int pid;
+	int ret = fscanf(children, "%d", &pid);
+	if (ret == EOF) {
+	    /* The process may have exited while we were reading; that's
+	     * fine, it just means it has no more children. */
+	    if (ferror(children) && errno != ESRCH) {
+		err(1, "fscanf failed");
+	    }
+	    break;
+	}
+	if (ret != 1) {
+	    errx(1, "Failed to parse children of %d", parent);
+	}
+	visit(census, pid, parent, statusfd);
+    }
+    fclose(children);
+}
+
+/* Calls visit on each child of each thread of pid. */
+void visit_children(struct census *census, const pid_t pid,
+		    void (*visit)(struct census *census, pid_t pid, pid_t parent, int statusfd),
+		    const int statusfd) {
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "/proc/%d/task", pid);
+    DIR *taskdir = opendir(buf);
+    /* The process has already exited. */
+    if (!taskdir) return;
+    struct dirent *tident;
+    while ((tident = readdir(taskdir)) != NULL) {
+	int tid;
+	if (sscanf(tident->d_name, "%d", &tid) != 1) continue;
+	snprintf(buf, sizeof(buf), "/proc/%d/task/%d/children", pid, tid);
+	FILE *children = fopen(buf, "re");
+	/* The thread has already exited. */
+	if (!children) continue;
+	visit_children_stream(children, census, pid, visit, statusfd);
+    }
+    closedir(taskdir);
+}
+
+void visit_child(struct census *census, const pid_t pid, const pid_t parent, const int statusfd) {
+    /* We already know this is our child. */
+    if (census->ppid[pid] == parent) return;
+    /* If it was a descendant we knew about, we know its previous parent. */
+    const pid_t previous = census->ppid[pid];
+    census->ppid[pid] = parent;
+    census->children[census->nchildren++] = pid;
+    /* Our child can't stop being our child until we collect it, so
+     * there's no risk of signaling a reused pid. */
+    if (census->new_child_signal) {
+	try_(kill(pid, census->new_child_signal));
+    }
+    if (census->subscribed) {
+	write_census_event(statusfd, SUPERVISE_REPARENTED, pid, previous, 0);
+    }
+}
+
+void visit_descendant(struct census *census, const pid_t pid, const pid_t parent, const int statusfd) {
+    (void)statusfd;
+    /* We already saw this pid elsewhere in the tree, because it was
+     * reparented while we were walking. */
+    if (census->ppid[pid] != 0) return;
+    census->ppid[pid] = parent;
+    census->descendants[census->ndescendants++] = pid;
+}
+
+/* Calls visit_child on each of our children, found by iterating /proc. */
+void visit_proc_children(struct census *census, const int statusfd) {
+    DIR* procdir = opendir("/proc");
+    if (!procdir) err(1, "Failed to opendir(/proc)");
+    struct dirent *pident;
+    while ((pident = readdir(procdir)) != NULL) {
+	int pid;
+	if (sscanf(pident->d_name, "%d", &pid) != 1) continue;
+	if (ppid_of(pid) != census->mypid) continue;
+	visit_child(census, pid, census->mypid, statusfd);
+    }
+    closedir(procdir);
+}
+
+bool census_supported(void) {
+    FILE* children = get_children_stream(syscall(SYS_getpid));
+    if (!children) return false;
+    fclose(children);
+    return true;
+}
+
+struct census *census_create(void) {
+    struct census *census = calloc(1, sizeof(*census));
+    if (!census) err(1, "Failed to allocate census");
+    /* get my pid, bypassing glibc pid cache */
+    census->mypid = syscall(SYS_getpid);
+    /* These are sized for PID_MAX_LIMIT rather than the current
+     * pid_max, which can be raised while we're running. That's 16MB
+     * each, but calloc gets fresh zero pages from the kernel, so we
+     * only pay for the pids we touch. */
+    census->ppid = calloc(CENSUS_PID_LIMIT, sizeof(pid_t));
+    census->children = calloc(CENSUS_PID_LIMIT, sizeof(pid_t));
+    census->descendants = calloc(CENSUS_PID_LIMIT, sizeof(pid_t));
+    if (!census->ppid || !census->children || !census->descendants) {
+	err(1, "Failed to allocate census");
+    }
+    /* Not subscribed yet, so our existing children aren't reported. */
+    census_scan_children(census, -1);
+    return census;
+}
+
+void census_forget(struct census *census, const pid_t pid) {
+    if (census->ppid[pid] == census->mypid) {
+	census->ppid[pid] = 0;
+    }
+}
+
+void census_scan_children(struct census *census, const int statusfd) {
+    /* Drop children that we've reaped since the last scan. */
+    int kept = 0;
+    for (int i = 0; i < census->nchildren; i++) {
+	const pid_t pid = census->children[i];
+	if (census->ppid[pid] == census->mypid) {
+	    census->children[kept++] = pid;
+	}
+    }
+    census->nchildren = kept;
+    /* We're single-threaded, so all our children are children of our
+     * main thread. */
+    FILE *children = get_children_stream(census->mypid);
+    if (children) {
+	visit_children_stream(children, census, census->mypid, visit_child, statusfd);
+    } else {
+	/* Without /proc/pid/task/tid/children, fall back to checking
+	 * the ppid of every process, as filicide does. That's slow, but
+	 * it only happens after a SUPERVISE_TERMINATE, since
+	 * SUPERVISE_CENSUS isn't supported on such systems. */
+	visit_proc_children(census, statusfd);
+    }
+}
+
+void census_walk(struct census *census) {
+    /* Forget the descendants from the last walk; some of them may have
+     * exited or been reparented since. We keep them around until now so
+     * that census_scan_children can report their previous parent. */
+    for (int i = 0; i < census->ndescendants; i++) {
+	const pid_t pid = census->descendants[i];
+	if (census->ppid[pid] != census->mypid) {
+	    census->ppid[pid] = 0;
+	}
+    }
+    census->ndescendants = 0;
+    for (int i = 0; i < census->nchildren; i++) {
+	visit_children(census, census->children[i], visit_descendant, -1);
+    }
+    /* Walk the tree breadth-first, using the descendants array as the
+     * queue; it grows as we visit. */
+    for (int i = 0; i < census->ndescendants; i++) {
+	visit_children(census, census->descendants[i], visit_descendant, -1);
+    }
+}
+
+void census_report(struct census *census, const int statusfd) {
+    census_scan_children(census, statusfd);
+    census_walk(census);
+    for (int i = 0; i < census->nchildren; i++) {
+	const pid_t pid = census->children[i];
+	write_census_event(statusfd, SUPERVISE_CENSUS_ENTRY, pid, census->mypid, 0);
+    }
+    for (int i = 0; i < census->ndescendants; i++) {
+	const pid_t pid = census->descendants[i];
+	write_census_event(statusfd, SUPERVISE_CENSUS_ENTRY, pid, census->ppid[pid], 0);
+    }
+    write_census_event(statusfd, SUPERVISE_CENSUS_END, 0, 0,
+		       census->nchildren + census->ndescendants);
+}
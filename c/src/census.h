@@ -0,0 +1,54 @@
+#pragma once
+#include <sys/types.h>
+#include <stdbool.h>
+
+/* PID_MAX_LIMIT on 64-bit Linux; pid_max can never be raised above
+ * this. It's not exported to userspace headers. */
+#define CENSUS_PID_LIMIT (1 << 22)
+
+/* Our knowledge of our children and their descendants. Our children
+ * are kept up to date between SUPERVISE_CENSUS requests; our other
+ * descendants are rescanned on every request, since we aren't told
+ * when they change. */
+struct census {
+    pid_t mypid;
+    /* ppid[pid] is the last parent we saw for pid, or 0 if pid is not
+     * known to be a child or descendant. Indexed by pid. */
+    pid_t *ppid;
+    /* Our immediate children, as of the last scan. May contain pids
+     * which have since been reaped, which are dropped on the next scan. */
+    pid_t *children;
+    int nchildren;
+    /* Our non-immediate descendants, as of the last walk. Only kept
+     * so that census_scan_children can report the previous parent of
+     * a reparented child. */
+    pid_t *descendants;
+    int ndescendants;
+    /* Whether to write SUPERVISE_REPARENTED events. */
+    bool subscribed;
+    /* If nonzero, sent to each new child as soon as any scan finds it. */
+    int new_child_signal;
+};
+
+/* Returns true if this kernel has /proc/pid/task/tid/children, which
+ * the census needs; it's missing without CONFIG_PROC_CHILDREN. */
+bool census_supported(void);
+
+/* Allocates a census and records our current children. This works
+ * even if !census_supported(), but only census_scan_children may be
+ * used then, and it has to iterate over /proc. Children which
+ * already exist when this is called are not reported as reparented. */
+struct census *census_create(void);
+
+/* Forgets a child that we have reaped. */
+void census_forget(struct census *census, pid_t pid);
+
+/* Updates our set of children, writing a SUPERVISE_REPARENTED event to
+ * statusfd for each new child if the census is subscribed, and sending
+ * it new_child_signal if set. This is cheap, since it only reads our
+ * own children list. */
+void census_scan_children(struct census *census, int statusfd);
+
+/* Updates our children and walks their descendants, then writes the
+ * whole census to statusfd. */
+void census_report(struct census *census, int statusfd);
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 int try_function(const int ret,
 		 const char *file, const int line, const char *function, const char *program)
@@ -54,6 +55,78 @@ void disable_sigpipe(void) {
     try_(sigaction(SIGPIPE, &sa, NULL));
 }
 
+/* Messages which we couldn't write to statusfd yet because it was
+ * full. They're written out by flush_status when statusfd is
+ * writable again, so a slow reader can never make us fail. */
+struct pending_status {
+    size_t size;
+    char buf[sizeof(siginfo_t)];
+};
+struct pending_status *pending = NULL;
+size_t pending_head = 0;
+size_t pending_count = 0;
+size_t pending_capacity = 0;
+
+/* Returns false if statusfd is full. */
+bool try_write_status(const int statusfd, void const* buf, const size_t size) {
+    const ssize_t written = write(statusfd, buf, size);
+    if (written == -1) {
+	if (errno == EAGAIN) {
+	    return false;
+	} else if (errno == EPIPE) {
+	    // do nothing, we don't care if the other end hung up
+	} else {
+	    err(1, "Failed to write(statusfd, buf, size)");
+	}
+    } else if (written != (ssize_t)size) {
+	/* We should not get any partial writes since we're writing less
+	 * than PIPE_BUF, but nevertheless... */
+	errx(1, "Inexplicable partial write on statusfd");
+    }
+    return true;
+}
+
+void write_status(const int statusfd, void const* buf, const size_t size) {
+    if (statusfd == -1) return;
+    /* preserve ordering behind anything already queued */
+    if (!status_pending() && try_write_status(statusfd, buf, size)) return;
+    if (size > sizeof(pending->buf)) {
+	errx(1, "Status message of size %zu is too large to queue", size);
+    }
+    if (pending_count == pending_capacity) {
+	pending_capacity = pending_capacity ? pending_capacity * 2 : 64;
+	pending = realloc(pending, pending_capacity * sizeof(*pending));
+	if (!pending) err(1, "Failed to allocate status queue");
+    }
+    pending[pending_count].size = size;
+    memcpy(pending[pending_count].buf, buf, size);
+    pending_count++;
+}
+
+bool status_pending(void) {
+    return pending_head != pending_count;
+}
+
+void flush_status(const int statusfd) {
+    while (status_pending()) {
+	struct pending_status const* msg = &pending[pending_head];
+	if (!try_write_status(statusfd, msg->buf, msg->size)) return;
+	pending_head++;
+    }
+    discard_status();
+}
+
+void flush_status_blocking(const int statusfd) {
+    if (statusfd == -1 || !status_pending()) return;
+    const int fl_flags = try_(fcntl(statusfd, F_GETFL));
+    try_(fcntl(statusfd, F_SETFL, fl_flags & ~O_NONBLOCK));
+    flush_status(statusfd);
+}
+
+void discard_status(void) {
+    pending_head = pending_count = 0;
+}
+
 int str_to_int(char const* str) {
     errno = 0;
     int ret = strtol(str, NULL, 10);
@@ -1,6 +1,7 @@
 #pragma once
 #include <signal.h>
 #include <stdio.h>
+#include <stdbool.h>
 int try_function(int ret, const char *file, int line, const char *function, const char *program);
 
 /* a minor utility macro to check return codes and exit if <0. */
@@ -18,6 +19,20 @@ int get_childfd(void);
 
 /* Marks SIGPIPE as ignored. */
 void disable_sigpipe(void);
+/* Writes a message to statusfd, or queues it if statusfd is full.
+ * Does nothing if statusfd is -1, and ignores EPIPE, since we don't
+ * care if the other end hung up. */
+void write_status(int statusfd, void const* buf, size_t size);
+/* Returns true if there are queued messages; poll for POLLOUT on
+ * statusfd and call flush_status to write them. */
+bool status_pending(void);
+/* Writes as many queued messages as statusfd has room for. */
+void flush_status(int statusfd);
+/* Writes all queued messages, blocking until statusfd has room. Used
+ * right before exiting, so this clears O_NONBLOCK on statusfd. */
+void flush_status_blocking(int statusfd);
+/* Throws away queued messages, for when statusfd is closed. */
+void discard_status(void);
 /* Convert passed string to an integer */
 int str_to_int(char const* str);
 
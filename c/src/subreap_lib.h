@@ -1,5 +1,6 @@
 #pragma once
 #include <signal.h>
+#include <stdio.h>
 
 /* On return, we guarantee that the current process has no more children. */
 void filicide(void);
@@ -13,6 +14,13 @@ void sanity_check(void);
  * This function also blocks those signals. */
 int get_fatalfd(void);
 
+/* Returns the parent of pid, or -1 if there is no such pid. */
+pid_t ppid_of(pid_t pid);
+
+/* Returns a stream listing the children of pid's main thread, or NULL
+ * if the kernel doesn't support /proc/pid/task/tid/children. */
+FILE *get_children_stream(pid_t pid);
+
 /* Sends a signal to all children, guaranteed. But it iterates /proc,
  * so could be slow. */
 void signal_all_children(int signum);
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <err.h>
 #include <errno.h>
@@ -13,14 +14,30 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include "common.h"
 #include "subreap_lib.h"
+#include "census.h"
 #include "supervise_protocol.h"
 
 bool called_filicide = false;
+/* NULL until the first SUPERVISE_CENSUS or SUPERVISE_TERMINATE
+ * request, so we don't pay for tracking our children unless someone
+ * asks. */
+struct census *census = NULL;
+/* -1 until the first SUPERVISE_TERMINATE request; then it's a timerfd
+ * which is readable when the grace period expires. */
+int termfd = -1;
+enum supervise_terminate_phase terminate_phase = SUPERVISE_TERMINATE_NONE;
 
 void filicide_once() {
     if (!called_filicide) {
+	/* however we came to filicide, the grace period is over */
+	if (terminate_phase != SUPERVISE_TERMINATE_NONE) {
+	    terminate_phase = SUPERVISE_TERMINATE_FORCED;
+	}
+	/* everything is getting SIGKILL, no point in SIGTERM */
+	if (census) census->new_child_signal = 0;
 	filicide();
         called_filicide = true;
     }
@@ -36,18 +53,87 @@ void handle_send_signal(struct supervise_send_signal signal) {
     }
 }
 
-void read_controlfd(const int controlfd) {
+void handle_census(const int subscribe, const int statusfd) {
+    if (!census_supported()) {
+	const struct supervise_event event = {
+	    .type = SUPERVISE_COMMAND_FAILED, .status = SUPERVISE_CENSUS,
+	};
+	write_status(statusfd, &event, sizeof(event));
+	return;
+    }
+    if (!census) census = census_create();
+    if (subscribe) census->subscribed = true;
+    census_report(census, statusfd);
+}
+
+void handle_terminate(const int grace_ms, const int statusfd) {
+    if (called_filicide) return;
+    if (terminate_phase == SUPERVISE_TERMINATE_NONE) {
+	terminate_phase = SUPERVISE_TERMINATE_GRACEFUL;
+    }
+    if (!census) census = census_create();
+    census_scan_children(census, statusfd);
+    /* Only our immediate children are signaled, not all our
+     * descendants: our children can't stop being our children until we
+     * collect them, so there's no risk of signaling a reused pid. */
+    for (int i = 0; i < census->nchildren; i++) {
+	try_(kill(census->children[i], SIGTERM));
+    }
+    /* Descendants which are orphaned during the grace period become
+     * our children, and are signaled by whichever scan finds them. */
+    census->new_child_signal = SIGTERM;
+    if (grace_ms <= 0) {
+	/* a zero timerfd is disarmed, so escalate immediately */
+	filicide_once();
+	return;
+    }
+    if (termfd == -1) {
+	termfd = try_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC));
+    }
+    const struct itimerspec deadline = {
+	.it_value = { .tv_sec = grace_ms / 1000, .tv_nsec = (grace_ms % 1000) * 1000000 },
+    };
+    struct itimerspec current;
+    try_(timerfd_gettime(termfd, &current));
+    const bool armed = current.it_value.tv_sec || current.it_value.tv_nsec;
+    const bool later = current.it_value.tv_sec < deadline.it_value.tv_sec ||
+	(current.it_value.tv_sec == deadline.it_value.tv_sec &&
+	 current.it_value.tv_nsec <= deadline.it_value.tv_nsec);
+    /* don't push back a deadline we've already promised */
+    if (armed && later) return;
+    try_(timerfd_settime(termfd, 0, &deadline, NULL));
+}
+
+void handle_command(struct supervise_command command, const int statusfd) {
+    switch (command.type) {
+    case SUPERVISE_CENSUS: handle_census(command.arg, statusfd); break;
+    case SUPERVISE_TERMINATE: handle_terminate(command.arg, statusfd); break;
+    /* ignore commands we don't know, just like signals to non-children */
+    default: break;
+    }
+}
+
+void read_controlfd(const int controlfd, const int statusfd) {
     int size;
-    struct supervise_send_signal signal;
-    /* read a pid/signal pair to send */
-    while ((size = try_(read(controlfd, &signal, sizeof(signal)))) > 0) {
+    union {
+	struct supervise_send_signal signal;
+	struct supervise_command command;
+    } msg;
+    _Static_assert(sizeof(msg.signal) == sizeof(msg.command),
+		   "commands must be the same size as signals");
+    /* read a pid/signal pair to send, or a command */
+    while ((size = try_(read(controlfd, &msg, sizeof(msg)))) > 0) {
 	/* NOTE we assume we don't get partial reads. This is fine
          * since we're reading/writing in quantities less than
          * PIPE_BUF, so it's atomic. Nevertheless... */
-        if (size != sizeof(signal)) {
+        if (size != sizeof(msg)) {
             errx(1, "Inexplicable partial read from controlfd");
         }
-	handle_send_signal(signal);
+	if (msg.signal.pid < 0) {
+	    handle_command(msg.command, statusfd);
+	} else {
+	    handle_send_signal(msg.signal);
+	}
     }
 }
 
@@ -61,10 +147,20 @@ void read_fatalfd(const int fatalfd) {
     }
 }
 
-/* TODO ideally we would be able to write notifications for when
- * children are reparented to us. then we could signal them... but
- * maybe our owner already knows about our children through other
- * sources? so we still allow signaling everything. */
+void read_termfd(const int termfd) {
+    uint64_t expirations;
+    if (try_(read(termfd, &expirations, sizeof(expirations))) == sizeof(expirations)) {
+	/* the grace period is over */
+        filicide_once();
+	/* we will now exit in read_childfd when we see we have no children left */
+    }
+}
+
+/* Children can be reparented to us without us getting a SIGCHLD, if
+ * their parent was a grandchild rather than a child. So
+ * SUPERVISE_REPARENTED events are only prompt for the orphans of our
+ * immediate children; the rest are noticed on the next SIGCHLD or
+ * SUPERVISE_CENSUS. */
 void read_childfd(int childfd, int statusfd) {
     struct signalfd_siginfo siginfo;
     /* signalfds can't have partial reads */
@@ -74,26 +170,28 @@ void read_childfd(int childfd, int statusfd) {
 	    childinfo.si_pid = 0;
 	    const int ret = waitid(P_ALL, 0, &childinfo, WEXITED|WNOHANG);
 	    if (ret == -1 && errno == ECHILD) {
+		if (terminate_phase != SUPERVISE_TERMINATE_NONE) {
+		    const struct supervise_event event = {
+			.type = SUPERVISE_TERMINATED, .status = terminate_phase,
+		    };
+		    write_status(statusfd, &event, sizeof(event));
+		}
+		/* don't lose any events the reader hasn't had room for yet */
+		flush_status_blocking(statusfd);
 		exit(0);
 	    }
 	    /* no child was in a waitable state */
 	    if (childinfo.si_pid == 0) break;
-	    // if statusfd is -1, we don't care about printing status messages
-	    if (statusfd != -1) {
-                size_t written = write(statusfd, &childinfo, sizeof(childinfo));
-		if (written == -1) {
-		    if (errno == EPIPE) {
-			// do nothing, we don't care if the other end hung up
-		    } else {
-			err(1, "Failed to write(statusfd, &childinfo, sizeof(childinfo))");
-		    }
-		} else if (written != sizeof(childinfo)) {
-		    /* We should not get any partial writes since we're writing less
-		     * than PIPE_BUF, but nevertheless... */
-                    errx(1, "Inexplicable partial write on statusfd");
-                }
+	    if (census && (childinfo.si_code == CLD_EXITED ||
+			   childinfo.si_code == CLD_KILLED ||
+			   childinfo.si_code == CLD_DUMPED)) {
+		census_forget(census, childinfo.si_pid);
 	    }
+	    // if statusfd is -1, we don't care about printing status messages
+	    write_status(statusfd, &childinfo, sizeof(childinfo));
         }
+	/* any children of a child which just exited are now our children */
+	if (census) census_scan_children(census, statusfd);
     }
 }
 
@@ -109,15 +207,19 @@ int supervise(const int controlfd, int statusfd) {
     const int fatalfd = get_fatalfd();
     const int childfd = get_childfd();
 
-    struct pollfd pollfds[4] = {
+    struct pollfd pollfds[5] = {
 	{ .fd = controlfd, .events = POLLIN|POLLRDHUP, .revents = 0, },
 	{ .fd = statusfd, .events = POLLHUP, .revents = 0, },
 	{ .fd = childfd, .events = POLLIN, .revents = 0, },
 	{ .fd = fatalfd, .events = POLLIN, .revents = 0, },
+	/* poll ignores this until it's set by a SUPERVISE_TERMINATE request */
+	{ .fd = -1, .events = POLLIN, .revents = 0, },
     };
     for (;;) {
-	try_(poll(pollfds, 4, -1));
-	if (pollfds[0].revents & POLLIN) read_controlfd(controlfd);
+	pollfds[1].events = POLLHUP | (status_pending() ? POLLOUT : 0);
+	pollfds[4].fd = termfd;
+	try_(poll(pollfds, 5, -1));
+	if (pollfds[0].revents & POLLIN) read_controlfd(controlfd, statusfd);
 	if (pollfds[0].revents & (POLLERR|POLLNVAL|POLLRDHUP|POLLHUP)) {
 	    close(controlfd);
 	    pollfds[0].fd = -1;
@@ -134,6 +236,9 @@ int supervise(const int controlfd, int statusfd) {
 	    close(statusfd);
 	    pollfds[1].fd = -1;
 	    statusfd = -1;
+	    discard_status();
+	} else if (pollfds[1].revents & POLLOUT) {
+	    flush_status(statusfd);
 	}
 	if (pollfds[2].revents & POLLIN) {
 	    read_childfd(childfd, statusfd);
@@ -141,10 +246,16 @@ int supervise(const int controlfd, int statusfd) {
 	if (pollfds[3].revents & POLLIN) {
 	    read_fatalfd(fatalfd);
 	}
+	if (pollfds[4].revents & POLLIN) {
+	    read_termfd(termfd);
+	}
 	if ((pollfds[2].revents & (POLLERR|POLLHUP|POLLNVAL)) ||
 	    (pollfds[3].revents & (POLLERR|POLLHUP|POLLNVAL))) {
 	    errx(1, "Error event returned by poll for signalfd");
 	}
+	if (pollfds[4].revents & (POLLERR|POLLHUP|POLLNVAL)) {
+	    errx(1, "Error event returned by poll for timerfd");
+	}
     }
 }
 
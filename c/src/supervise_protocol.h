@@ -1,6 +1,7 @@
 #ifndef	_SUPERVISE_PROTOCOL_H
 #define	_SUPERVISE_PROTOCOL_H	1
 #include <sys/types.h>
+#include <signal.h>
 
 /* Send supervise_send_signal on the controlfd */
 struct supervise_send_signal {
@@ -8,7 +9,69 @@ struct supervise_send_signal {
     int signal;
 };
 
+/* Send supervise_command on the controlfd to make a request other
+ * than sending a signal. It is the same size as supervise_send_signal,
+ * and is distinguished from it by having a negative
+ * supervise_command_type where supervise_send_signal has its pid. */
+struct supervise_command {
+    int type;
+    int arg;
+};
+
+enum supervise_command_type {
+    /* Write a SUPERVISE_CENSUS_ENTRY event on the statusfd for each
+     * child and each known descendant, then a SUPERVISE_CENSUS_END
+     * event. If arg is nonzero, also write a SUPERVISE_REPARENTED
+     * event from now on whenever a new child is reparented to us. */
+    SUPERVISE_CENSUS = -1,
+    /* Send SIGTERM to all children, then if any processes remain
+     * after arg milliseconds, SIGKILL all transitive children as if
+     * the controlfd had closed. A later request can bring the deadline
+     * forward, but not push it back. When the last process exits, a
+     * SUPERVISE_TERMINATED event is written. */
+    SUPERVISE_TERMINATE = -2,
+};
+
 /* Receive siginfo_t (defined in signal.h) on the statusfd for every
  * child status change. */
 
+/* Receive supervise_event on the statusfd in response to
+ * supervise_commands. It is the same size as siginfo_t, and is
+ * distinguished from it by having 0 where siginfo_t has si_signo,
+ * which is always SIGCHLD for child status changes. */
+enum supervise_event_type {
+    /* pid is a descendant and ppid is its parent. */
+    SUPERVISE_CENSUS_ENTRY = 1,
+    /* The census is complete; status is the number of entries. */
+    SUPERVISE_CENSUS_END = 2,
+    /* pid was reparented to us; ppid is its previous parent, or 0 if
+     * we didn't know about it. */
+    SUPERVISE_REPARENTED = 3,
+    /* All processes have exited after a SUPERVISE_TERMINATE; status
+     * is the supervise_terminate_phase that ended them. */
+    SUPERVISE_TERMINATED = 4,
+    /* supervise can't carry out a command on this system; status is
+     * the supervise_command_type. */
+    SUPERVISE_COMMAND_FAILED = 5,
+};
+
+enum supervise_terminate_phase {
+    /* No SUPERVISE_TERMINATE was requested; never sent. */
+    SUPERVISE_TERMINATE_NONE = 0,
+    /* Everything exited within the grace period. */
+    SUPERVISE_TERMINATE_GRACEFUL = 1,
+    /* We had to SIGKILL everything. */
+    SUPERVISE_TERMINATE_FORCED = 2,
+};
+
+struct supervise_event {
+    /* always 0 */
+    int zero;
+    int type;
+    pid_t pid;
+    pid_t ppid;
+    int status;
+    char padding[sizeof(siginfo_t) - 3*sizeof(int) - 2*sizeof(pid_t)];
+};
+
 #endif /* supervise_protocol.h */
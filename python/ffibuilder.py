@@ -19,7 +19,39 @@ struct supervise_send_signal {
     pid_t pid;
     int signal;
 };
+struct supervise_command {
+    int type;
+    int arg;
+};
+enum supervise_command_type {
+    SUPERVISE_CENSUS,
+    SUPERVISE_TERMINATE,
+    ...
+};
+enum supervise_event_type {
+    SUPERVISE_CENSUS_ENTRY,
+    SUPERVISE_CENSUS_END,
+    SUPERVISE_REPARENTED,
+    SUPERVISE_TERMINATED,
+    SUPERVISE_COMMAND_FAILED,
+    ...
+};
+enum supervise_terminate_phase {
+    SUPERVISE_TERMINATE_NONE,
+    SUPERVISE_TERMINATE_GRACEFUL,
+    SUPERVISE_TERMINATE_FORCED,
+    ...
+};
+struct supervise_event {
+    int zero;
+    int type;
+    pid_t pid;
+    pid_t ppid;
+    int status;
+    ...;
+};
 typedef struct siginfo {
+    int      si_signo;     /* Signal number */
     int      si_code;      /* Signal code */
     pid_t    si_pid;       /* Sending process ID */
     uid_t    si_uid;       /* Real user ID of sending process */
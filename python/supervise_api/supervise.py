@@ -14,6 +14,7 @@ import sfork
 from supervise_api._raw import lib, ffi
 import typing as t
 import enum
+import collections
 from dataclasses import dataclass
 import signal
 import prctl
@@ -61,6 +62,37 @@ class ChildEvent:
         else:
             return cls(code, pid, uid, None, signal.Signals(struct.si_status))
 
+class SuperviseEventType(enum.Enum):
+    CENSUS_ENTRY = lib.SUPERVISE_CENSUS_ENTRY # pid is a descendant, and ppid its parent
+    CENSUS_END = lib.SUPERVISE_CENSUS_END # census is complete, status is the number of entries
+    REPARENTED = lib.SUPERVISE_REPARENTED # pid was reparented to supervise from ppid
+    TERMINATED = lib.SUPERVISE_TERMINATED # all processes exited, status is the TerminatePhase
+    COMMAND_FAILED = lib.SUPERVISE_COMMAND_FAILED # command unsupported on this system, status is the command
+
+class TerminatePhase(enum.Enum):
+    GRACEFUL = lib.SUPERVISE_TERMINATE_GRACEFUL # everything exited within the grace period
+    FORCED = lib.SUPERVISE_TERMINATE_FORCED # everything was SIGKILLed
+
+@dataclass
+class SuperviseEvent:
+    """An event written by supervise in response to a command, rather than a child status change."""
+    type: SuperviseEventType
+    pid: int
+    ppid: int
+    status: int
+    @classmethod
+    def parse(cls, buf: bytes) -> 'SuperviseEvent':
+        struct = ffi.cast('struct supervise_event*', ffi.from_buffer(buf))
+        return cls(SuperviseEventType(struct.type), int(struct.pid), int(struct.ppid), int(struct.status))
+
+def parse_event(buf: bytes) -> t.Union[ChildEvent, SuperviseEvent]:
+    """Parse a single message read from the supervise fd."""
+    # supervise_event has 0 where siginfo_t has si_signo
+    if ffi.cast('siginfo_t*', ffi.from_buffer(buf)).si_signo == 0:
+        return SuperviseEvent.parse(buf)
+    else:
+        return ChildEvent.parse(buf)
+
 def ignore_sigchld():
     """Mark SIGCHLD as SIG_IGN. Doing this explicitly prevents zombies."""
     signal.signal(signal.SIGCHLD, signal.SIG_IGN)
@@ -293,6 +325,8 @@ class Process:
     # true if we are certain there are no more children left (only
     # false while running)
     childfree = False
+    # how terminate_tree() ended the tree - None if not yet ended that way
+    terminate_phase: t.Optional[TerminatePhase] = None
     def __init__(self, *args, **kwargs):
         """Follows the same argument conventions as dfork
 
@@ -300,6 +334,8 @@ class Process:
         """
         self.fd, self.pid = dfork(*args, **kwargs)
         self.fd.setblocking(0)
+        # events read by census() while waiting for the census, not yet returned by get_event
+        self.__queued_events: t.Deque[t.Union[ChildEvent, SuperviseEvent]] = collections.deque()
 
     def closed(self):
         """Returns true if supervise communication fd is closed."""
@@ -336,16 +372,20 @@ class Process:
             else:
                 raise
 
-    def __handle_event(self, event: ChildEvent) -> None:
+    def __handle_event(self, event: t.Union[ChildEvent, SuperviseEvent]) -> None:
         """Handle a single event"""
+        if isinstance(event, SuperviseEvent):
+            if event.type is SuperviseEventType.TERMINATED:
+                self.terminate_phase = TerminatePhase(event.status)
+            return
         if event.pid != self.pid:
             # we only care about the main pid, but get events for everything
             return
         if event.died():
             self.final_event = event
 
-    def get_event(self) -> t.Optional[ChildEvent]:
-        """Return new event (oldest first), or None if no new events"""
+    def __receive_event(self) -> t.Optional[t.Union[ChildEvent, SuperviseEvent]]:
+        """Read and handle a single event from the fd, or return None if there are none."""
         buf = self.__read_event()
         if buf is None:
             return None
@@ -353,10 +393,24 @@ class Process:
             self.childfree = True
             self.close()
             return None
-        event = ChildEvent.parse(buf)
+        event = parse_event(buf)
         self.__handle_event(event)
         return event
 
+    def get_event(self) -> t.Optional[t.Union[ChildEvent, SuperviseEvent]]:
+        """Return new event (oldest first), or None if no new events
+
+        SuperviseEvents are only returned after a command such as
+        request_census() has been sent.
+
+        Events which arrived during census() are queued and returned
+        first; the fd won't be readable for them, so call this until it
+        returns None after calling census().
+        """
+        if self.__queued_events:
+            return self.__queued_events.popleft()
+        return self.__receive_event()
+
     def new_events(self):
         """Return iterator over unprocessed events."""
         return iter(self.get_event, None)
@@ -379,12 +433,13 @@ class Process:
     def wait(self) -> ChildEvent:
         """Wait for the main process to exit."""
         while True:
-            _ = select.select([self], [], [])
+            # flush first, in case census() already read the final event
             self.flush_events()
             if self.closed():
                 raise Exception("Process was abruptly closed, no final status available")
             elif self.final_event is not None:
                 return self.final_event
+            _ = select.select([self], [], [])
 
     def send_signal(self, signum: signal.Signals):
         """Send this signal to the main child process."""
@@ -396,6 +451,48 @@ class Process:
         buf = bytes(ffi.buffer(msg))
         self.fd.send(buf)
 
+    def __send_command(self, type: int, arg: int) -> None:
+        if self.closed():
+            raise Exception("Communication fd is already closed")
+        msg = ffi.new('struct supervise_command*', {'type':type, 'arg':arg})
+        buf = bytes(ffi.buffer(msg))
+        self.fd.send(buf)
+
+    def request_census(self, subscribe: bool=False) -> None:
+        """Ask supervise to report all the processes in this tree.
+
+        The census arrives as CENSUS_ENTRY events followed by a
+        CENSUS_END event. If subscribe is true, supervise will also
+        send a REPARENTED event whenever it notices a new child from
+        now on, so the tree can be tracked without repeated censuses.
+        """
+        self.__send_command(lib.SUPERVISE_CENSUS, int(subscribe))
+
+    def census(self, subscribe: bool=False) -> t.Dict[int, int]:
+        """Return a mapping from each process in this tree to its parent.
+
+        Other events received while waiting for the census, including
+        REPARENTED events if subscribe is true, are queued to be
+        returned by get_event().
+        """
+        self.request_census(subscribe)
+        entries: t.Dict[int, int] = {}
+        while True:
+            _ = select.select([self], [], [])
+            for event in iter(self.__receive_event, None):
+                if isinstance(event, SuperviseEvent) and event.type is SuperviseEventType.CENSUS_ENTRY:
+                    entries[event.pid] = event.ppid
+                elif isinstance(event, SuperviseEvent) and event.type is SuperviseEventType.CENSUS_END:
+                    return entries
+                elif (isinstance(event, SuperviseEvent) and
+                      event.type is SuperviseEventType.COMMAND_FAILED and
+                      event.status == lib.SUPERVISE_CENSUS):
+                    raise Exception("supervise can't take a census on this system")
+                else:
+                    self.__queued_events.append(event)
+            if self.closed():
+                raise Exception("Process was abruptly closed, no census available")
+
     def terminate(self):
         """Terminate the main child process with SIGTERM.
 
@@ -404,6 +501,17 @@ class Process:
         """
         self.send_signal(signal.SIGTERM)
 
+    def terminate_tree(self, grace_period: float) -> None:
+        """Terminate all processes, giving them grace_period seconds to exit.
+
+        supervise sends SIGTERM to its immediate children, and to any
+        processes reparented to it during the grace period. If any
+        processes are left when the grace period expires, it kills all
+        descendent processes as close() does. Once everything has
+        exited, terminate_phase is set to say which happened.
+        """
+        self.__send_command(lib.SUPERVISE_TERMINATE, int(grace_period * 1000))
+
     def kill(self):
         """Kill the main child process with SIGKILL.
 
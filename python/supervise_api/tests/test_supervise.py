@@ -10,6 +10,8 @@ import errno
 import sys
 import pathlib
 import shutil
+import select
+import time
 
 def collect_children():
     collected = False
@@ -197,6 +199,60 @@ class TestSupervise(unittest.TestCase):
     def test_setsid_and_nohup(self):
         self.multifork("nohup setsid sleep inf 2>/dev/null")
 
+    def test_census(self):
+        proc = supervise_api.Process(["sh", "-c", "sleep inf & sleep inf & wait"])
+        # wait for the inner sleeps to be forked
+        while len(proc.census()) < 3:
+            pass
+        census = proc.census(subscribe=True)
+        sleeps = set(pid for pid, ppid in census.items() if ppid == proc.pid)
+        self.assertIn(proc.pid, census)
+        self.assertEqual(len(sleeps), 2)
+        proc.kill()
+        # the orphaned sleeps are reparented to supervise
+        reparented = set()
+        while True:
+            for event in proc.new_events():
+                if isinstance(event, supervise_api.SuperviseEvent):
+                    self.assertEqual(event.type, supervise_api.SuperviseEventType.REPARENTED)
+                    self.assertEqual(event.ppid, proc.pid)
+                    reparented.add(event.pid)
+            if proc.final_event is not None and len(reparented) == 2:
+                break
+            select.select([proc], [], [])
+        self.assertEqual(proc.final_event.killed_with(), signal.SIGKILL)
+        self.assertEqual(reparented, sleeps)
+        proc.close()
+
+    def test_terminate_tree_graceful(self):
+        proc = supervise_api.Process(["sleep", "inf"])
+        proc.terminate_tree(60)
+        self.assertEqual(proc.wait_tree().killed_with(), signal.SIGTERM)
+        self.assertEqual(proc.terminate_phase, supervise_api.TerminatePhase.GRACEFUL)
+
+    def test_terminate_tree_graceful_grandchild(self):
+        # the sleep is only signaled once it's reparented to supervise
+        proc = supervise_api.Process(["sh", "-c", "sleep inf & wait"])
+        proc.terminate_tree(60)
+        self.assertEqual(proc.wait_tree().killed_with(), signal.SIGTERM)
+        self.assertEqual(proc.terminate_phase, supervise_api.TerminatePhase.GRACEFUL)
+
+    def test_terminate_tree_graceful_census(self):
+        # the sleep is orphaned during the grace period without a
+        # SIGCHLD to supervise, so the census is the first to find it
+        proc = supervise_api.Process(["sh", "-c", "trap ':' TERM; sh -c 'sleep inf & sleep 0.3' & wait; sleep 0.6"])
+        proc.terminate_tree(60)
+        time.sleep(0.4)
+        proc.census()
+        self.assertEqual(proc.wait_tree().clean(), True)
+        self.assertEqual(proc.terminate_phase, supervise_api.TerminatePhase.GRACEFUL)
+
+    def test_terminate_tree_forced(self):
+        proc = supervise_api.Process(["sh", "-c", "trap '' TERM; sleep inf & wait"])
+        proc.terminate_tree(0.1)
+        self.assertEqual(proc.wait_tree().killed_with(), signal.SIGKILL)
+        self.assertEqual(proc.terminate_phase, supervise_api.TerminatePhase.FORCED)
+
     def test_flags_default_cloexec(self):
         proc = supervise_api.Process(["sh", "-c", "sleep inf"])
         inheritable = os.get_inheritable(proc.fileno())